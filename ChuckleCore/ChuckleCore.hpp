@@ -13,8 +13,11 @@
 #include <Paper2/Tarp/TarpRenderer.hpp>
 #include <Pic/Image.hpp>
 #include <Stick/FixedArray.hpp>
+#include <Stick/HashMap.hpp>
 #include <Stick/SystemClock.hpp>
 
+#include <atomic>
+
 //@TODO: do we really need to include imgui here? maybe forward declare some stuff instead?
 #include "imgui.h"
 
@@ -68,19 +71,173 @@ STICK_API stick::Maybe<const char *> fileDialog(FileDialogFlags _flags,
                                                 const char * _defaultPath = NULL,
                                                 const char * _defaultName = NULL);
 
+// Linear allocator that hands out memory by bumping a pointer. Deallocation is a no-op, all memory
+// is released at once by calling reset. Mainly meant for transient per frame data.
+class STICK_API LinearFrameAllocator : public Allocator
+{
+  public:
+    static constexpr Size s_defaultChunkSize = 1024 * 1024;
+
+    LinearFrameAllocator(Allocator & _parent = defaultAllocator(),
+                         Size _chunkSize = s_defaultChunkSize);
+    ~LinearFrameAllocator();
+
+    mem::Block allocate(Size _byteCount, Size _alignment) override;
+    void deallocate(const mem::Block & _block) override;
+
+    // makes all memory available again. If more than one chunk was needed since the last reset,
+    // the chunks are merged into one big enough to hold everything.
+    void reset();
+
+    Size bytesUsed() const;
+    Size capacity() const;
+
+  private:
+    struct Chunk
+    {
+        mem::Block block;
+        Size used;
+    };
+
+    void freeChunks();
+
+    Allocator * m_parent;
+    Size m_chunkSize;
+    DynamicArray<Chunk> m_chunks;
+    Size m_currentChunk;
+};
+
+struct AllocationStats
+{
+    Size allocationCount;
+    Size deallocationCount;
+    Size bytesAllocated;
+    Size bytesDeallocated;
+    // highest number of live bytes
+    Size peakBytes;
+};
+
+// Allocator that forwards to a parent allocator and counts allocations and bytes. The counters are
+// updated atomically so it can be shared between threads. The frame statistics cover everything
+// since the last call to beginFrame.
+class STICK_API TrackingAllocator : public Allocator
+{
+  public:
+    TrackingAllocator(Allocator & _parent = defaultAllocator());
+
+    mem::Block allocate(Size _byteCount, Size _alignment) override;
+    void deallocate(const mem::Block & _block) override;
+
+    void beginFrame();
+    AllocationStats frameStats() const;
+    Size liveBytes() const;
+    Size totalAllocationCount() const;
+
+  private:
+    Allocator * m_parent;
+    std::atomic<Size> m_liveBytes;
+    std::atomic<Size> m_totalAllocationCount;
+    std::atomic<Size> m_frameAllocationCount;
+    std::atomic<Size> m_frameDeallocationCount;
+    std::atomic<Size> m_frameBytesAllocated;
+    std::atomic<Size> m_frameBytesDeallocated;
+    std::atomic<Size> m_framePeakBytes;
+};
+
+// View into the data of an asset. Only valid as long as the AssetPack it came from is open.
+struct AssetView
+{
+    const UInt8 * data;
+    Size byteCount;
+};
+
+// Read only archive of assets that is memory mapped as a whole, so that looking up an asset does
+// not copy or allocate anything. Packs are created with the AssetPacker tool, the format is
+// described in ChuckleCore/Private/AssetPackFormat.hpp.
+class STICK_API AssetPack
+{
+  public:
+    AssetPack();
+    ~AssetPack();
+    AssetPack(const AssetPack &) = delete;
+    AssetPack & operator=(const AssetPack &) = delete;
+
+    Error open(const char * _path);
+    // opens _fileName located in the directory of the executable.
+    Error openFromExecutableDirectory(const char * _fileName = "Assets.pack");
+    void close();
+    bool isOpen() const;
+
+    Maybe<AssetView> asset(const char * _name) const;
+    bool hasAsset(const char * _name) const;
+    Size assetCount() const;
+    const char * assetName(Size _index) const;
+    AssetView assetAt(Size _index) const;
+
+  private:
+    const UInt8 * m_data;
+    Size m_byteCount;
+    Size m_entryCount;
+};
+
 class STICK_API ImGuiInterface : public stick::EventForwarder
 {
   public:
     ImGuiInterface();
     ~ImGuiInterface();
+    // If _fontURI is NULL, the default font that is compiled into the library is used.
+    // If _bCacheFontAtlas is true, the baked font atlas is stored next to the executable and
+    // restored from there on subsequent runs with the same font, size and scale factor. This is
+    // off by default as the executable directory is not necessarily writable.
     Error init(RenderDevice & _renderDevice,
                Window & _window,
                const char * _fontURI,
-               Float32 _fontSize);
+               Float32 _fontSize,
+               Allocator & _alloc = defaultAllocator(),
+               bool _bCacheFontAtlas = false);
+    // same as above, using TTF data from memory (i.e. an AssetPack) which has to outlive the
+    // interface as it is not copied.
+    Error init(RenderDevice & _renderDevice,
+               Window & _window,
+               const void * _fontData,
+               Size _fontDataByteCount,
+               Float32 _fontSize,
+               Allocator & _alloc = defaultAllocator(),
+               bool _bCacheFontAtlas = false);
     Error newFrame(Float64 _deltaTime);
     Error finalizeFrame(RenderPass * _pass);
 
+    // number of draw lists whose upload was skipped in the last frame because their geometry did
+    // not change.
+    Size skippedUploadCount() const;
+    // same as above, summed up over all frames.
+    Size totalSkippedUploadCount() const;
+    // number of draw calls issued for the ui in the last frame.
+    Size drawCallCount() const;
+
   private:
+    // every ImDrawList gets its own buffers so that its data can be uploaded straight from imgui
+    struct DrawListBuffers
+    {
+        VertexBuffer * vertexBuffer;
+        IndexBuffer * indexBuffer;
+        Mesh * mesh;
+        // what was uploaded last, to detect if the list changed since the previous frame
+        UInt64 hash;
+        Size vertexCount;
+        Size indexCount;
+    };
+
+    Error initImpl(RenderDevice & _renderDevice,
+                   Window & _window,
+                   void * _fontData,
+                   Size _fontDataByteCount,
+                   bool _bFontDataOwned,
+                   Float32 _fontSize,
+                   Allocator & _alloc,
+                   bool _bCacheFontAtlas);
+    Error reserveDrawListBuffers(Size _count);
+
     // the window that the ui is drawn to and dispatches the events to the UI
     Window * m_window;
     // all rendering primitives to render the imgui ui
@@ -89,16 +246,19 @@ class STICK_API ImGuiInterface : public stick::EventForwarder
     Pipeline * m_pipeline;
     PipelineVariable * m_projPVar;
     PipelineTexture * m_pipeTex;
-    VertexBuffer * m_vertexBuffer;
-    IndexBuffer * m_indexBuffer;
-    Mesh * m_mesh;
+    // the font atlas is single channel and drawn with its own program
+    Program * m_fontProgram;
+    Pipeline * m_fontPipeline;
+    PipelineVariable * m_fontProjPVar;
+    DynamicArray<DrawListBuffers> m_drawListBuffers;
     Texture * m_texture;
     Sampler * m_sampler;
     // some other helpers
     UInt64 m_time;
     bool m_bMousePressed[3];
-    DynamicArray<ImDrawVert> m_vertexDrawData;
-    DynamicArray<ImDrawIdx> m_indexDrawData;
+    Size m_skippedUploadCount;
+    Size m_totalSkippedUploadCount;
+    Size m_drawCallCount;
 };
 
 class STICK_API QuickDraw
@@ -132,9 +292,17 @@ class STICK_API QuickDraw
 
     using DrawCallBuffer = stick::DynamicArray<DrawCall>;
 
+    struct CullingStats
+    {
+        Size submitted;
+        Size culled;
+    };
+
     QuickDraw();
 
-    Error init(RenderDevice * _rd, stick::Allocator & _alloc);
+    Error init(RenderDevice * _rd,
+               stick::Allocator & _alloc,
+               const BlendSettings & _blendSettings = BlendSettings());
 
     void setViewport(Float32 _x, Float32 _y, Float32 _w, Float32 _h);
     void setTransform(const Mat4f & _transform);
@@ -153,6 +321,17 @@ class STICK_API QuickDraw
     const Mat4f & projection() const;
     const Mat4f & transformProjection() const;
 
+    // If enabled, primitives that are entirely outside of the viewport (using the current
+    // transform and projection) are skipped on the CPU. Points, lines and rects are culled
+    // individually, everything else as a whole.
+    void setCullingEnabled(bool _b);
+    bool isCullingEnabled() const;
+    // culling statistics of the last flushed frame
+    const CullingStats & cullingStats() const;
+    // checks if the provided rectangle in the current transform space overlaps the viewport. The
+    // viewport is enlarged by half a pixel to account for the width of points and lines.
+    bool isVisible(Float32 _minX, Float32 _minY, Float32 _maxX, Float32 _maxY) const;
+
     void addToPass(
         RenderPass * _pass); // will queue the currently buffered draw commands on the provided pass
     void flush(); // should be called once per frame just before any renderpass that has been
@@ -201,6 +380,11 @@ class STICK_API QuickDraw
     const Sampler * nearestSampler() const;
 
   private:
+    template <class T>
+    bool isVisible(const T * _ptr, Size _count) const;
+    // returns true if culling is enabled and the rectangle is not visible, updates the stats
+    bool cull(Float32 _minX, Float32 _minY, Float32 _maxX, Float32 _maxY);
+
     template <class T>
     void addDrawCall(const T *,
                      Size,
@@ -230,6 +414,9 @@ class STICK_API QuickDraw
     Mesh * m_mesh;
     GeometryBuffer m_geometryBuffer;
     DrawCallBuffer m_drawCalls;
+    bool m_bCulling;
+    CullingStats m_cullingStats;
+    CullingStats m_currentCullingStats;
 };
 
 // namespace detail
@@ -249,11 +436,28 @@ class STICK_API RenderWindow : public Window
     using DrawFunction = std::function<Error(Float64)>;
     using FrameFinishedCallback = std::function<Error()>;
 
+    // time in seconds spent setting up the subsystems of the window. The subsystems that are
+    // created lazily stay at zero until they are used.
+    struct StartupTimings
+    {
+        Float64 window;
+        Float64 renderDevice;
+        Float64 quickDraw;
+        Float64 ui;
+    };
+
     RenderWindow();
     virtual ~RenderWindow();
 
     Error open(const WindowSettings & _settings);
-    Error enableDefaultUI(const char * _uiFontURI = NULL, Float32 _uiFontSize = 14.0f);
+    // see ImGuiInterface::init for _bCacheFontAtlas
+    Error enableDefaultUI(const char * _uiFontURI = NULL,
+                          Float32 _uiFontSize = 14.0f,
+                          bool _bCacheFontAtlas = false);
+    // uses a font from memory, i.e. from an AssetPack. The data has to outlive the window.
+    Error enableDefaultUI(const AssetView & _uiFont,
+                          Float32 _uiFontSize = 14.0f,
+                          bool _bCacheFontAtlas = false);
     void setShowWindowMetrics(bool _b);
     void toggleShowWindowMetrics();
     ImageUniquePtr frameImage(UInt32 _x, UInt32 _y, UInt32 _w, UInt32 _h);
@@ -267,12 +471,36 @@ class STICK_API RenderWindow : public Window
 
     void setTargetFps(Float64 _fps);
     void removeTargetFps();
+
+    // If enabled, run only renders a frame if input was received, requestRedraw was called or the
+    // idle redraw interval elapsed. Otherwise it just polls for events at a low rate, which keeps
+    // idle windows from burning CPU. Every event is followed by a couple of frames so that the UI
+    // can settle, and frames keep coming while an ImGui widget is active or wants text input.
+    void setOnDemandRendering(bool _b);
+    bool isOnDemandRendering() const;
+    // schedules a frame when rendering on demand, safe to call from any thread.
+    void requestRedraw();
+    // when rendering on demand, render at least every _seconds (i.e. for clocks, timers).
+    void setIdleRedrawInterval(Float64 _seconds);
+    void removeIdleRedrawInterval();
     Float64 fps() const;
     Float64 targetFps() const;
     Size frameCount() const;
     bool isShowingWindowMetrics() const;
     ImGuiInterface * imGuiInterface();
+    // QuickDraw is initialized on first use. Call initQuickDraw to do it explicitly and handle
+    // potential errors, otherwise they are returned from run().
+    Error initQuickDraw();
     QuickDraw & quickDraw();
+    const StartupTimings & startupTimings() const;
+    // allocator for transient data that only needs to live until the end of the current frame.
+    // It is reset after each iteration of run.
+    LinearFrameAllocator & frameAllocator();
+    // the allocator used by the window and its subsystems (QuickDraw, ImGuiInterface, overlay
+    // buffers), which tracks how much memory they allocate.
+    TrackingAllocator & allocator();
+    // allocation statistics of the last finished frame
+    const AllocationStats & allocationStats() const;
 
     void drawPathOutline(Path * _path,
                          RenderInterface & _paperRenderer,
@@ -298,17 +526,66 @@ class STICK_API RenderWindow : public Window
                                        const ColorRGBA & _col,
                                        bool _bDrawChildren = false);
 
+    // The flattened vertices used to draw path outlines are cached per path and only recomputed
+    // if the segments or the transform of the path changed. Entries of paths that were not drawn
+    // for s_outlineCacheMaxAge frames are removed automatically.
+    void invalidateOutlineCache(Path * _path);
+    void clearOutlineCache();
+
+    // If set, outlines are flattened by ChuckleCore with the provided maximum deviation (in
+    // absolute coordinates) rather than using the flattening of the paper renderer.
+    void setOutlineTolerance(Float32 _tolerance);
+    void removeOutlineTolerance();
+
   protected:
-    void drawPathOutlineHelper(Path * _path, RenderInterface & _paperRenderer, bool _bDrawChildren);
+    static constexpr Size s_outlineCacheMaxAge = 120;
+    // number of frames rendered after each event when rendering on demand. ImGui needs more than
+    // one frame to reflect some interactions (i.e. hover states, windows appearing).
+    static constexpr Size s_redrawSettleFrameCount = 3;
+    // how long to sleep between polling for events while idle
+    static constexpr Float64 s_idlePollIntervalMS = 10.0;
+    // upper limit of the delta time passed to the first frame after being idle, if that frame was
+    // triggered by input or requestRedraw rather than the idle redraw interval
+    static constexpr Float64 s_maxResumeDeltaTime = 1.0 / 60.0;
+
+    // declared first so that it outlives all members that allocate from it
+    TrackingAllocator m_allocator;
+    AllocationStats m_allocationStats;
+    StartupTimings m_startupTimings;
+
+    struct OutlineCacheEntry
+    {
+        UInt64 version;
+        Size lastUsedFrame;
+        DynamicArray<Vec2f> vertices;
+    };
+
+    using OutlineCache = stick::HashMap<Path *, OutlineCacheEntry>;
+
+    void drawPathOutlineHelper(Path * _path,
+                               RenderInterface & _paperRenderer,
+                               const Mat32f & _transform,
+                               const ColorRGBA & _col,
+                               bool _bDrawChildren);
+    const DynamicArray<Vec2f> & flattenedOutline(Path * _path, RenderInterface & _paperRenderer);
+    void removeStaleOutlines();
     void updateQuickDrawSize();
+    template <class EventT>
+    void redrawOnEvent();
+    bool needsRedraw();
 
     RenderDevice * m_renderDevice;
+    // only created once a frame is saved
     ImageUniquePtr m_tmpImage;
     DrawFunction m_drawFunc;
     FrameFinishedCallback m_frameFinishedCallback;
     SystemClock m_clock;
     Maybe<SystemClock::TimePoint> m_lastFrameTime;
+    bool m_bQuickDrawInitialized;
+    // set if initializing QuickDraw failed
+    Error m_quickDrawError;
     QuickDraw m_quickDraw;
+    LinearFrameAllocator m_frameAllocator;
 
     // imgui stuffs
     stick::UniquePtr<ImGuiInterface> m_gui;
@@ -322,18 +599,147 @@ class STICK_API RenderWindow : public Window
 
     stick::Maybe<Float64> m_targetFps;
     Size m_frameCount;
+
+    bool m_bOnDemandRendering;
+    bool m_bResumingFromIdle;
+    std::atomic<bool> m_bRedrawRequested;
+    Size m_pendingRedrawFrameCount;
+    stick::Maybe<Float64> m_idleRedrawInterval;
+
+    // the map and the vertices of its entries allocate from m_allocator
+    OutlineCache m_outlineCache;
+    Maybe<Float32> m_outlineTolerance;
+    // transformed outline vertices of all paths passed to drawMultiplePathOutlines, drawn as a
+    // single line list
+    DynamicArray<QuickDraw::Vertex> m_outlineVertices;
+    // scratch buffers for the handle and bounding box overlays
+    DynamicArray<Vec2f> m_handleRects;
+    DynamicArray<Vec2f> m_handleLines;
+    DynamicArray<QuickDraw::Vertex> m_boundingBoxVertices;
+};
+
+// Dynamic bounding volume hierarchy over the absolute stroke bounds of paper items, which matches
+// what document culling tests against. Every item is stored with slightly enlarged bounds so that
+// small movements don't require touching the tree. Paper does not notify about changes, so call
+// update for items that were modified (or updateAll to check all of them, which only touches the
+// tree for items that moved outside of their enlarged bounds). Items that get removed from the
+// document have to be removed from the index, too.
+class STICK_API SpatialIndex
+{
+  public:
+    SpatialIndex(Float32 _margin = 4.0f, Allocator & _alloc = defaultAllocator());
+
+    // adds all paths and symbols in the hierarchy of _root
+    void insertHierarchy(Item * _root);
+    void insert(Item * _item);
+    void remove(Item * _item);
+    void update(Item * _item);
+    void updateAll();
+    void clear();
+    bool contains(Item * _item) const;
+    Size itemCount() const;
+
+    // appends all items whose bounds overlap _rect to _outItems
+    void query(const Rectf & _rect, DynamicArray<Item *> & _outItems) const;
+    // appends all items whose bounds contain _point to _outItems
+    void query(const Vec2f & _point, DynamicArray<Item *> & _outItems) const;
+
+  private:
+    struct Node
+    {
+        Vec2f min;
+        Vec2f max;
+        Item * item;
+        Int32 parent;
+        Int32 left;
+        Int32 right;
+        // height of the subtree, -1 for unused nodes
+        Int32 height;
+
+        bool isLeaf() const
+        {
+            return left == -1;
+        }
+    };
+
+    Int32 allocateNode();
+    void freeNode(Int32 _index);
+    void insertLeaf(Int32 _leaf);
+    void removeLeaf(Int32 _leaf);
+    Int32 balance(Int32 _index);
+    void refit(Int32 _index);
+    void setFatBounds(Int32 _leaf, const Rectf & _bounds);
+
+    Float32 m_margin;
+    DynamicArray<Node> m_nodes;
+    Int32 m_root;
+    Int32 m_freeList;
+    stick::HashMap<Item *, Int32> m_leaves;
+    mutable DynamicArray<Int32> m_stack;
 };
 
 class STICK_API PaperWindow : public RenderWindow
 {
   public:
+    struct DocumentCullingStats
+    {
+        Size drawn;
+        Size skipped;
+    };
+
     PaperWindow();
+    ~PaperWindow();
     Error open(const WindowSettings & _settings);
     Document & document();
+    // If document culling or cached groups are in use, drawDocument applies projection() to the
+    // renderer, so set the projection through setProjection rather than on the renderer directly.
     tarp::TarpRenderer & paperRenderer();
 
     void setAutoResize(bool _b);
     bool autoResize() const;
+
+    // sets the projection of the paper renderer. With auto resize enabled, it is reset to map the
+    // document to the window whenever the window is resized.
+    void setProjection(const Mat4f & _proj);
+    const Mat4f & projection() const;
+    // the part of the document that is visible with the current projection
+    Rectf visibleRect() const;
+    // size of one pixel in document units with the current projection
+    Float32 pixelSize() const;
+
+    // The tolerance used to flatten path outlines is given in pixels and converted to document
+    // units based on the current projection, so zooming out produces fewer vertices. It is only
+    // used if no tolerance was set through setOutlineTolerance.
+    void setFlatteningPixelTolerance(Float32 _pixels);
+    Float32 flatteningTolerance() const;
+    // If document culling is enabled, items that are smaller than this in both dimensions are
+    // skipped, too. Defaults to 0.
+    void setMinimumItemPixelSize(Float32 _pixels);
+
+    // If enabled, drawDocument hides items whose bounds are outside of visibleRect() while the
+    // document is rendered. Clipping masks are never hidden. Culling only happens once a
+    // projection was set through setProjection (auto resize does that).
+    void setDocumentCullingEnabled(bool _b);
+    bool isDocumentCullingEnabled() const;
+    // If enabled, document culling uses spatialIndex() to find the visible items instead of
+    // checking the bounds of every item. Off by default. The caller is responsible for keeping
+    // the index in sync: items that moved need to be updated (or call updateAll before drawing)
+    // and items have to be removed from the index before they are removed from the document.
+    void setSpatialIndexCullingEnabled(bool _b);
+    bool isSpatialIndexCullingEnabled() const;
+    // statistics of the last drawDocument call that was executed with culling enabled
+    const DocumentCullingStats & documentCullingStats() const;
+
+    // A cached group is rendered into an offscreen texture once, which is then composited in its
+    // place every time the document is drawn. The texture is only re-rendered if the group got
+    // invalidated or its bounds, the projection or the window size changed. The textures cover
+    // the whole window, so every change of the projection (i.e. panning and zooming) re-renders
+    // all cached groups. Groups inside of clipped groups can't be cached, setGroupCached returns
+    // an error for them. This can be called before the window is opened.
+    Error setGroupCached(Group * _group, bool _bCached);
+    bool isGroupCached(Group * _group) const;
+    void invalidateCachedGroup(Group * _group);
+
     void drawDocument(RenderPass * _pass);
     void drawPathOutline(Path * _path, const ColorRGBA & _col, bool _bDrawChildren = true);
     void drawMultiplePathOutlines(Path ** _paths,
@@ -341,12 +747,88 @@ class STICK_API PaperWindow : public RenderWindow
                                   const ColorRGBA & _col,
                                   bool _bDrawChildren = true);
 
+    // spatial index for picking and visibility queries on the document. It is empty until
+    // items are added to it, i.e. via spatialIndex().insertHierarchy(&document()).
+    SpatialIndex & spatialIndex();
+    // appends all items in the spatial index whose bounds contain _point to _outItems
+    void itemsAt(const Vec2f & _point, DynamicArray<Item *> & _outItems) const;
+
   protected:
     void updateDocumentSize();
+    struct CachedLayer
+    {
+        Group * group;
+        RenderBuffer * renderBuffer;
+        Texture * colorTarget;
+        Texture * depthStencilTarget;
+        UInt32 width;
+        UInt32 height;
+        Rectf bounds;
+        Mat4f projection;
+        bool bDirty;
+    };
 
+    // visibility information of an item while the document is drawn in multiple steps (cached
+    // layers split the document in runs of uncached items). An item is visible during a step if
+    // it lies in [firstStep, lastStep].
+    struct StepItem
+    {
+        Item * item;
+        Size firstStep;
+        Size lastStep;
+        bool bWasVisible;
+    };
+
+    struct RenderStep
+    {
+        // -1 for runs of uncached items
+        Int32 layerIndex;
+    };
+
+    bool isItemCulled(Item * _item, const Rectf & _visibleRect) const;
+    void cullItems(Item * _item, const Rectf & _visibleRect);
+    Error drawDocumentCulled();
+    void destroyLayerTargets(CachedLayer & _layer);
+    Error updateLayerTargets(CachedLayer & _layer);
+    Int32 cachedLayerIndex(Item * _item) const;
+    void buildRenderSteps(Item * _item,
+                          Size & _step,
+                          bool & _bRunHasContent,
+                          Size & _outFirst,
+                          Size & _outLast);
+    Error drawStep(Size _step);
+    void restoreStepVisibility();
+    Error drawDocumentLayered(RenderPass * _pass);
+
+    // allocates from RenderWindow::m_allocator so that it shows up in the allocation stats
     Document m_doc;
+    // allocates its geometry through tarp, which uses malloc directly and can't be tracked
     tarp::TarpRenderer m_paperRenderer;
     bool m_bAutoResize;
+    SpatialIndex m_spatialIndex;
+    Mat4f m_projection;
+    bool m_bProjectionSet;
+    bool m_bDocumentCulling;
+    DocumentCullingStats m_documentCullingStats;
+    // items that are temporarily hidden while rendering the document
+    DynamicArray<Item *> m_culledItems;
+    // sorted spatial index query results of the current culling pass
+    DynamicArray<Item *> m_visibleIndexedItems;
+    bool m_bSpatialIndexCulling;
+    // whether the current culling pass uses the spatial index
+    bool m_bCullWithSpatialIndex;
+    DynamicArray<CachedLayer> m_cachedLayers;
+    DynamicArray<StepItem> m_stepItems;
+    DynamicArray<RenderStep> m_renderSteps;
+    // used to composite the cached layers, initialized by the first drawDocumentLayered call
+    QuickDraw m_layerDraw;
+    bool m_bLayerDrawInitialized;
+    // sample count of the window, used for the cached layer render buffers
+    UInt32 m_sampleCount;
+    Float32 m_flatteningPixelTolerance;
+    Float32 m_minimumItemPixelSize;
+    // m_minimumItemPixelSize in document units, updated before culling
+    Float32 m_minimumItemSize;
 };
 
 // template <class BaseWindowT>
@@ -382,16 +864,83 @@ class STICK_API PaperWindow : public RenderWindow
 // directly.
 namespace path
 {
+// index of a curve inside its path and its cached arc length
+struct CurveLength
+{
+    Size index;
+    Float length;
+};
+
+// Writes the _count longest curves of _path to _output, sorted from longest to shortest.
 STICK_API void longestCurves(Path * _path, Size _count, DynamicArray<Curve> & _output);
 
-STICK_API void matchSegmentCount(Path * _a, Path * _b);
+// Same as above but reuses _scratch to cache the curve lengths to avoid allocating on every call.
+STICK_API void longestCurves(Path * _path,
+                             Size _count,
+                             DynamicArray<Curve> & _output,
+                             DynamicArray<CurveLength> & _scratch);
+
+// Subdivides the path with fewer segments until both have the same segment count. All splits are
+// planned up front so that the longest curves are divided into equally long parts. Returns an error
+// if the path with fewer segments has no curves to subdivide.
+STICK_API Error matchSegmentCount(Path * _a, Path * _b);
 
 STICK_API void applyNoise(
     Item * _item, Float32 _noiseSeed, Float32 _noiseDiv, Float32 _noiseScale, Float32 _sampleDist);
 
+// Same as applyNoise but processes whole paths (flattening, noise and smoothing) on multiple
+// threads. The paths themselves are only read and modified on the calling thread. Flattening and
+// smoothing work on copies of the segments, so the results may differ slightly from applyNoise.
+STICK_API void applyNoiseParallel(
+    Item * _item, Float32 _noiseSeed, Float32 _noiseDiv, Float32 _noiseScale, Float32 _sampleDist);
+
+// Interpolates between _a and _b (which need to have the same segment count) and writes the result
+// to _output. If _output already has a matching layout, its segments are updated in place.
 STICK_API void morph(Path * _a, Path * _b, Float32 _t, Path * _output);
 } // namespace path
 
+// Morphs between two Group/Path hierarchies of the same structure. All the expensive preprocessing
+// (matching the segment counts of corresponding paths) happens once in init. The resulting
+// keyframes are stored as flat arrays so that evaluate only needs to interpolate them.
+class STICK_API HierarchyMorph
+{
+  public:
+    struct PathTriple
+    {
+        Path * from;
+        Path * to;
+        Path * output;
+    };
+
+    HierarchyMorph(Allocator & _alloc = defaultAllocator());
+
+    // _from, _to and _output need to share the same structure. Note that this modifies _from and
+    // _to: their paths are subdivided to match their segment counts. Pass clones if the originals
+    // need to stay untouched. The paths in _output will be overwritten.
+    Error init(Item * _from, Item * _to, Item * _output);
+    void evaluate(Float32 _t);
+    Size pathCount() const;
+
+  private:
+    struct PathRange
+    {
+        Path * output;
+        Size offset;
+        Size count;
+    };
+
+    DynamicArray<PathRange> m_paths;
+    DynamicArray<Vec2f> m_position;
+    DynamicArray<Vec2f> m_positionDelta;
+    DynamicArray<Vec2f> m_handleIn;
+    DynamicArray<Vec2f> m_handleInDelta;
+    DynamicArray<Vec2f> m_handleOut;
+    DynamicArray<Vec2f> m_handleOutDelta;
+    DynamicArray<Vec2f> m_resultPosition;
+    DynamicArray<Vec2f> m_resultHandleIn;
+    DynamicArray<Vec2f> m_resultHandleOut;
+};
+
 } // namespace chuckle
 
 #endif // CHUCKLECORE_CHUCKLECORE_HPP
@@ -0,0 +1,58 @@
+#ifndef CHUCKLECORE_PRIVATE_ASSETPACKFORMAT_HPP
+#define CHUCKLECORE_PRIVATE_ASSETPACKFORMAT_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Shared by ChuckleCore and the AssetPacker tool, hence no dependencies other than the standard
+// library. All values are stored in native byte order. A pack is laid out as follows:
+//
+// Header | Entry[entryCount] (sorted by nameHash) | zero terminated names | aligned blobs
+//
+// Every blob starts at a multiple of blobAlignment so that views into the mapped file can be used
+// directly (i.e. for SIMD loads or as texture data).
+
+namespace chuckle
+{
+namespace assetpack
+{
+static constexpr std::uint32_t magic = 0x50414B43; // "CKAP"
+static constexpr std::uint32_t version = 1;
+static constexpr std::uint64_t blobAlignment = 64;
+
+struct Header
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t entryCount;
+    std::uint64_t entriesOffset;
+    std::uint64_t namesOffset;
+    std::uint64_t namesByteCount;
+};
+
+struct Entry
+{
+    std::uint64_t nameHash;
+    // relative to Header::namesOffset
+    std::uint64_t nameOffset;
+    std::uint64_t nameLength;
+    // relative to the beginning of the file
+    std::uint64_t dataOffset;
+    std::uint64_t byteCount;
+};
+
+// FNV-1a
+inline std::uint64_t hashName(const char * _name, std::size_t _length)
+{
+    std::uint64_t ret = 14695981039346656037ULL;
+    for (std::size_t i = 0; i < _length; ++i)
+    {
+        ret ^= (std::uint8_t)_name[i];
+        ret *= 1099511628211ULL;
+    }
+    return ret;
+}
+} // namespace assetpack
+} // namespace chuckle
+
+#endif // CHUCKLECORE_PRIVATE_ASSETPACKFORMAT_HPP
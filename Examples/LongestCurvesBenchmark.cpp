@@ -0,0 +1,78 @@
+#include <ChuckleCore/ChuckleCore.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace chuckle;
+
+// Measures path::longestCurves on paths with many curves and compares it to sorting all curves by
+// length, which evaluates the arc length of a curve on every comparison.
+
+static void sortAllCurves(Path * _path, Size _count, DynamicArray<Curve> & _output)
+{
+    _output.clear();
+    for (auto curve : _path->curves())
+        _output.append(curve);
+
+    std::sort(_output.begin(), _output.end(), [](const Curve & _a, const Curve & _b) {
+        return _a.length() > _b.length();
+    });
+    if (_output.count() > _count)
+        _output.resize(_count);
+}
+
+static Path * createWigglyPath(Document & _doc, Size _curveCount)
+{
+    // curves of varying length and bend so that none of them have the same length
+    Path * ret = _doc.createPath();
+    for (Size i = 0; i <= _curveCount; ++i)
+    {
+        Float32 x = static_cast<Float32>(i) * 10.0f;
+        Float32 y = std::sin(static_cast<Float32>(i) * 0.37f) * 50.0f;
+        Float32 h = 2.0f + std::abs(std::cos(static_cast<Float32>(i) * 0.11f)) * 8.0f;
+        ret->addSegment(Vec2f(x, y), Vec2f(-h, h), Vec2f(h, -h));
+    }
+    return ret;
+}
+
+template <class F>
+static Float64 averageMilliseconds(Size _iterationCount, F _func)
+{
+    SystemClock clock;
+    auto start = clock.now();
+    for (Size i = 0; i < _iterationCount; ++i)
+        _func();
+    return (clock.now() - start).seconds() * 1000.0 / static_cast<Float64>(_iterationCount);
+}
+
+int main(int _argc, const char * _args[])
+{
+    const Size curveCounts[] = { 10000, 50000, 100000 };
+    const Size longestCount = 100;
+    const Size iterationCount = 10;
+
+    Document doc("Benchmark");
+    DynamicArray<Curve> output;
+    DynamicArray<path::CurveLength> scratch;
+    for (Size curveCount : curveCounts)
+    {
+        Path * p = createWigglyPath(doc, curveCount);
+
+        Float64 sortMS =
+            averageMilliseconds(iterationCount, [&]() { sortAllCurves(p, longestCount, output); });
+        Float64 longestMS = averageMilliseconds(
+            iterationCount, [&]() { path::longestCurves(p, longestCount, output); });
+        Float64 scratchMS = averageMilliseconds(
+            iterationCount, [&]() { path::longestCurves(p, longestCount, output, scratch); });
+
+        printf("%lu curves, %lu longest: sort all %.3f ms, longestCurves %.3f ms, with scratch "
+               "%.3f ms\n",
+               curveCount,
+               longestCount,
+               sortMS,
+               longestMS,
+               scratchMS);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,66 @@
+#include <ChuckleCore/ChuckleCore.hpp>
+
+using namespace chuckle;
+
+// Draws the path handle and bounding box overlays for a couple of frames and checks through the
+// window's TrackingAllocator that they stop allocating once their buffers have grown to size.
+
+#define RETURN_ON_ERR(_err)                                                                        \
+    if (_err)                                                                                      \
+    {                                                                                              \
+        printf("Error: %s\n", _err.message().cString());                                           \
+        return EXIT_FAILURE;                                                                       \
+    }
+
+int main(int _argc, const char * _args[])
+{
+    // the first frames size the overlay and QuickDraw buffers, everything after that has to reuse
+    // them.
+    const Size warmupFrameCount = 3;
+    const Size frameCount = 60;
+
+    PaperWindow window;
+    WindowSettings settings;
+    settings.setTitle("Overlay Allocation Check");
+    RETURN_ON_ERR(window.open(settings));
+
+    Document & doc = window.document();
+    DynamicArray<Path *> paths;
+    DynamicArray<Item *> items;
+    for (Size i = 0; i < 100; ++i)
+    {
+        Float32 x = static_cast<Float32>(i % 10) * 60.0f + 40.0f;
+        Float32 y = static_cast<Float32>(i / 10) * 60.0f + 40.0f;
+        Path * circle = doc.createCircle(Vec2f(x, y), 20);
+        circle->setFill("red");
+        paths.append(circle);
+        items.append(circle);
+    }
+
+    Size frame = 0;
+    Size steadyStateAllocationCount = 0;
+    window.setDrawFunction([&](Float64 _deltaTime) {
+        RenderDevice & rd = window.renderDevice();
+        RenderPass * pass = rd.beginPass(ClearSettings(0, 0, 0, 1));
+        window.drawDocument(pass);
+
+        AllocationStats before = window.allocator().frameStats();
+        window.drawMultiplePathHandles(paths.ptr(), paths.count(), ColorRGBA(1, 1, 1, 1));
+        window.drawMultipleItemBoundingBoxes(items.ptr(), items.count(), ColorRGBA(1, 0, 1, 1));
+        AllocationStats after = window.allocator().frameStats();
+
+        if (frame >= warmupFrameCount)
+            steadyStateAllocationCount += after.allocationCount - before.allocationCount;
+        if (++frame == frameCount)
+            window.close();
+
+        return rd.endPass(pass);
+    });
+
+    RETURN_ON_ERR(window.run());
+
+    printf("%lu allocations by the overlays over %lu frames after warming up\n",
+           steadyStateAllocationCount,
+           frameCount - warmupFrameCount);
+    return steadyStateAllocationCount ? EXIT_FAILURE : EXIT_SUCCESS;
+}
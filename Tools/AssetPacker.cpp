@@ -0,0 +1,157 @@
+// Packs files into an asset pack that can be memory mapped with chuckle::AssetPack.
+//
+// Usage: AssetPacker <output> <file>...
+//
+// Every file is stored under the path it was passed with. To store a file under a different name,
+// pass it as <name>=<file>.
+
+#include <ChuckleCore/Private/AssetPackFormat.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace chuckle;
+
+struct InputFile
+{
+    std::string name;
+    std::string path;
+    std::vector<unsigned char> data;
+};
+
+static bool readFile(const char * _path, std::vector<unsigned char> & _out)
+{
+    FILE * file = std::fopen(_path, "rb");
+    if (!file)
+        return false;
+
+    unsigned char buffer[4096];
+    std::size_t count;
+    while ((count = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+        _out.insert(_out.end(), buffer, buffer + count);
+
+    bool bSuccess = !std::ferror(file);
+    std::fclose(file);
+    return bSuccess;
+}
+
+static std::uint64_t alignUp(std::uint64_t _value, std::uint64_t _alignment)
+{
+    return (_value + _alignment - 1) / _alignment * _alignment;
+}
+
+int main(int _argc, char ** _argv)
+{
+    if (_argc < 3)
+    {
+        std::fprintf(stderr, "Usage: %s <output> <file>...\n", _argv[0]);
+        return 1;
+    }
+
+    std::vector<InputFile> files;
+    for (int i = 2; i < _argc; ++i)
+    {
+        InputFile f;
+        const char * sep = std::strchr(_argv[i], '=');
+        if (sep)
+        {
+            f.name.assign(_argv[i], sep - _argv[i]);
+            f.path = sep + 1;
+        }
+        else
+        {
+            f.name = f.path = _argv[i];
+        }
+
+        if (!readFile(f.path.c_str(), f.data))
+        {
+            std::fprintf(stderr, "Could not read %s\n", f.path.c_str());
+            return 1;
+        }
+        files.push_back(std::move(f));
+    }
+
+    // build the index, sorted by name hash so that the loader can binary search it
+    std::vector<assetpack::Entry> entries(files.size());
+    std::string names;
+    for (std::size_t i = 0; i < files.size(); ++i)
+    {
+        const std::string & name = files[i].name;
+        entries[i].nameHash = assetpack::hashName(name.c_str(), name.size());
+        entries[i].nameOffset = names.size();
+        entries[i].nameLength = name.size();
+        entries[i].byteCount = files[i].data.size();
+        names.append(name);
+        names.push_back('\0');
+    }
+
+    for (std::size_t i = 0; i < entries.size(); ++i)
+    {
+        for (std::size_t j = 0; j < i; ++j)
+        {
+            if (files[i].name == files[j].name)
+            {
+                std::fprintf(stderr, "Duplicate asset name %s\n", files[i].name.c_str());
+                return 1;
+            }
+        }
+    }
+
+    assetpack::Header header;
+    header.magic = assetpack::magic;
+    header.version = assetpack::version;
+    header.entryCount = entries.size();
+    header.entriesOffset = sizeof(assetpack::Header);
+    header.namesOffset = header.entriesOffset + entries.size() * sizeof(assetpack::Entry);
+    header.namesByteCount = names.size();
+
+    std::uint64_t offset = header.namesOffset + header.namesByteCount;
+    std::vector<std::size_t> order(files.size());
+    for (std::size_t i = 0; i < files.size(); ++i)
+    {
+        offset = alignUp(offset, assetpack::blobAlignment);
+        entries[i].dataOffset = offset;
+        offset += files[i].data.size();
+        order[i] = i;
+    }
+
+    std::sort(order.begin(), order.end(), [&entries](std::size_t _a, std::size_t _b) {
+        return entries[_a].nameHash < entries[_b].nameHash;
+    });
+
+    FILE * out = std::fopen(_argv[1], "wb");
+    if (!out)
+    {
+        std::fprintf(stderr, "Could not open %s\n", _argv[1]);
+        return 1;
+    }
+
+    std::fwrite(&header, sizeof(header), 1, out);
+    for (std::size_t idx : order)
+        std::fwrite(&entries[idx], sizeof(assetpack::Entry), 1, out);
+    std::fwrite(names.data(), 1, names.size(), out);
+
+    // blobs are written in the order of the input files
+    std::uint64_t written = header.namesOffset + header.namesByteCount;
+    const unsigned char padding[assetpack::blobAlignment] = {};
+    for (std::size_t i = 0; i < files.size(); ++i)
+    {
+        std::fwrite(padding, 1, entries[i].dataOffset - written, out);
+        std::fwrite(files[i].data.data(), 1, files[i].data.size(), out);
+        written = entries[i].dataOffset + files[i].data.size();
+    }
+
+    bool bSuccess = !std::ferror(out);
+    bSuccess = std::fclose(out) == 0 && bSuccess;
+    if (!bSuccess)
+    {
+        std::fprintf(stderr, "Could not write %s\n", _argv[1]);
+        std::remove(_argv[1]);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,57 @@
+// Small build tool that turns a binary file into a C++ source file defining a constant byte array
+// (and its size) in the chuckle::detail namespace, so that assets can be compiled into the library.
+//
+// Usage: EmbedFile <input> <output.cpp> <symbolName>
+
+#include <cstdio>
+#include <vector>
+
+int main(int _argc, char ** _argv)
+{
+    if (_argc != 4)
+    {
+        std::fprintf(stderr, "Usage: %s <input> <output.cpp> <symbolName>\n", _argv[0]);
+        return 1;
+    }
+
+    FILE * in = std::fopen(_argv[1], "rb");
+    if (!in)
+    {
+        std::fprintf(stderr, "Could not open %s\n", _argv[1]);
+        return 1;
+    }
+
+    std::vector<unsigned char> data;
+    unsigned char buffer[4096];
+    std::size_t count;
+    while ((count = std::fread(buffer, 1, sizeof(buffer), in)) > 0)
+        data.insert(data.end(), buffer, buffer + count);
+    std::fclose(in);
+
+    FILE * out = std::fopen(_argv[2], "w");
+    if (!out)
+    {
+        std::fprintf(stderr, "Could not open %s\n", _argv[2]);
+        return 1;
+    }
+
+    std::fprintf(out, "// Generated from %s by EmbedFile, do not edit.\n\n", _argv[1]);
+    std::fprintf(out, "#include <cstddef>\n\n");
+    std::fprintf(out, "namespace chuckle\n{\nnamespace detail\n{\n");
+    std::fprintf(out, "alignas(16) extern const unsigned char %s[] = {", _argv[3]);
+    for (std::size_t i = 0; i < data.size(); ++i)
+        std::fprintf(out, "%s0x%02x,", i % 16 == 0 ? "\n    " : " ", data[i]);
+    // never emit an empty array
+    if (data.empty())
+        std::fprintf(out, "0x00");
+    std::fprintf(out, "\n};\n");
+    std::fprintf(out,
+                 "extern const std::size_t %sByteCount = %lu;\n",
+                 _argv[3],
+                 (unsigned long)data.size());
+    std::fprintf(out, "} // namespace detail\n} // namespace chuckle\n");
+
+    bool bSuccess = !std::ferror(out);
+    bSuccess = std::fclose(out) == 0 && bSuccess;
+    return bSuccess ? 0 : 1;
+}